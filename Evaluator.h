@@ -2,12 +2,20 @@
 #define EVALUATOR_H
 
 #include "GameBoard.h"
+#include <cstddef>
 
 class ScoreEvaluator {
 public:
 	float evaluate(const GameBoard& board) const {
 		return board.getScore();
 	}
+
+	//! Evaluates n boards at once, storing the results into values.
+	void evaluate(const GameBoard::board_t* boards, float* values, std::size_t n) const {
+		for(std::size_t i = 0; i < n; i++) {
+			values[i] = BoardMethods::score_board(boards[i]);
+		}
+	}
 };
 
 class HeuristicEvaluator {
@@ -37,6 +45,15 @@ public:
                );
     }
 
+	//! Evaluates n boards at once, storing the results into values.
+	//! A plain loop: the lookups of the individual boards are independent,
+	//! so the CPU already overlaps their cache misses.
+	void evaluate(const GameBoard::board_t* boards, float* values, std::size_t n) const {
+		for(std::size_t i = 0; i < n; i++) {
+			values[i] = evaluate(GameBoard(boards[i]));
+		}
+	}
+
 public:
 	~HeuristicEvaluator() {
         //! Makes sure that table_initializer is initialized and init_tables called.
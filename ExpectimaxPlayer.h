@@ -0,0 +1,232 @@
+#ifndef EXPECTIMAX_PLAYER_H
+#define EXPECTIMAX_PLAYER_H
+
+#include "GameBoard.h"
+#include "Evaluator.h"
+#include "TranspositionTable.h"
+#include "SearchStats.h"
+#include "OpeningBook.h"
+#include <unordered_map>
+#include <chrono>
+#include <memory>
+#include <cstddef>
+
+/**
+ * A player that selects actions using a depth-limited expectimax search.
+ *
+ * Max nodes choose among the legal moves, chance nodes average over all
+ * possible tile spawns. Chance nodes are cached in a transposition table
+ * that is cleared before every move, unless a shared table is set using
+ * setSharedTable(): that one persists across moves and players. Branches
+ * whose cumulative probability drops below the probability threshold are
+ * not expanded any further and are evaluated directly instead.
+ *
+ * If an opening book is set, positions found in it are not searched.
+ *
+ * After each call to selectAction(), lastStats() describes the search.
+**/
+template<class Evaluator = HeuristicEvaluator>
+class ExpectimaxPlayer {
+public:
+	typedef GameBoard::board_t board_t;
+
+	//! The maximum number of children of a chance node: a 2 and a 4 for
+	//! each of the (at most 16) empty cells.
+	static constexpr std::size_t MAX_SPAWNS = 32;
+
+private:
+	struct CacheEntry {
+		unsigned int depth;
+		float value;
+	};
+
+private:
+	Evaluator _evaluator;
+	unsigned int _depth;
+	float _probThreshold;
+	std::unordered_map<board_t, CacheEntry> _cache;
+	std::shared_ptr<TranspositionTable> _sharedTable;
+	float _lastValue;
+	std::shared_ptr<const OpeningBook> _book;
+	SearchRecord _lastStats;
+	//! The counters of the thread running the current search.
+	ThreadSearchCounters* _counters;
+
+private:
+	float maxNode(board_t board, unsigned int depth, float prob) {
+		GAME2048_COUNT(_counters, MAX_NODES + (_depth - depth < SearchCounters::MAX_PLIES ?
+			_depth - depth : SearchCounters::MAX_PLIES - 1), 1);
+		float best = 0.0f;
+
+		for(auto action: {GameBoard::UP, GameBoard::DOWN, GameBoard::LEFT, GameBoard::RIGHT}) {
+			board_t after = GameBoard::execute_deterministic_move(board, action);
+			if(after == board) continue;
+			best = std::max(best, chanceNode(after, depth - 1, prob));
+		}
+
+		return best;
+	}
+
+	float chanceNode(board_t board, unsigned int depth, float prob) {
+		if(prob < _probThreshold) {
+			GAME2048_COUNT(_counters, PRUNED_BRANCHES, 1);
+			GAME2048_COUNT(_counters, EVALUATIONS, 1);
+			return _evaluator.evaluate(GameBoard(board));
+		}
+
+		GAME2048_COUNT(_counters, CHANCE_NODES, 1);
+		GAME2048_COUNT(_counters, CACHE_LOOKUPS, 1);
+
+		float cached;
+		if(lookup(board, depth, cached)) {
+			GAME2048_COUNT(_counters, CACHE_HITS, 1);
+			return cached;
+		}
+
+		const float prob4 = static_cast<float>(GameBoard::PROB4_TIMES_100) / 100.0f;
+		const float prob2 = 1.0f - prob4;
+		const int empty = GameBoard::count_empty(board);
+
+		float sum = 0.0f;
+
+		if(depth == 0) {
+			// All spawn children are leaves: score them as a single batch.
+			board_t children[MAX_SPAWNS];
+			float values[MAX_SPAWNS];
+			std::size_t n = 0;
+
+			for(board_t empty_cells = GameBoard::empty_mask(board); empty_cells; empty_cells &= empty_cells - 1) {
+				board_t tile = empty_cells & (~empty_cells + 1);
+				children[n++] = board | tile;
+				children[n++] = board | (tile << 1);
+			}
+
+			_evaluator.evaluate(children, values, n);
+			GAME2048_COUNT(_counters, EVALUATIONS, n);
+
+			for(std::size_t i = 0; i < n; i += 2) {
+				sum += prob2 * values[i] + prob4 * values[i+1];
+			}
+		} else {
+			for(board_t empty_cells = GameBoard::empty_mask(board); empty_cells; empty_cells &= empty_cells - 1) {
+				board_t tile = empty_cells & (~empty_cells + 1);
+				sum += prob2 * maxNode(board | tile, depth, prob * prob2 / empty);
+				sum += prob4 * maxNode(board | (tile << 1), depth, prob * prob4 / empty);
+			}
+		}
+
+		float value = sum / empty;
+		store(board, depth, value);
+		return value;
+	}
+
+	inline bool lookup(board_t board, unsigned int depth, float& value) const {
+		if(_sharedTable) return _sharedTable->lookup(board, depth, value);
+
+		auto iter = _cache.find(board);
+		if(iter == _cache.end() || iter->second.depth < depth) return false;
+		value = iter->second.value;
+		return true;
+	}
+
+	inline void store(board_t board, unsigned int depth, float value) {
+		if(_sharedTable) _sharedTable->store(board, depth, value);
+		else _cache[board] = CacheEntry{depth, value};
+	}
+
+public:
+	GameBoard::GameAction selectAction(const GameBoard& gameState) {
+		auto start = std::chrono::steady_clock::now();
+		_counters = &thread_search_counters();
+		SearchCounters before = _counters->snapshot();
+
+		board_t board = gameState.getBoardState();
+		_lastStats = SearchRecord();
+		_lastStats.depth = _depth;
+
+		GameBoard::GameAction bookAction;
+		if(_book && _book->lookup(board, bookAction, _lastValue) &&
+		   GameBoard::execute_deterministic_move(board, bookAction) != board)
+		{
+			_lastStats.bookHit = true;
+			_lastStats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			_lastStats.peakMemory = peak_memory_usage();
+			return bookAction;
+		}
+
+		_cache.clear();
+		GAME2048_COUNT(_counters, MAX_NODES, 1);
+
+		auto bestAction = GameBoard::None;
+		float bestValue = -1.0f;
+
+		for(auto action: {GameBoard::UP, GameBoard::DOWN, GameBoard::LEFT, GameBoard::RIGHT}) {
+			board_t after = GameBoard::execute_deterministic_move(board, action);
+			if(after == board) continue;
+
+			float value = chanceNode(after, _depth - 1, 1.0f);
+			if(value > bestValue) {
+				bestValue = value;
+				bestAction = action;
+			}
+		}
+
+		if(bestAction == GameBoard::None) throw IllegalAction("There is no legal action in this state.");
+		_lastValue = bestValue;
+
+		_lastStats.counters = _counters->snapshot() - before;
+		_lastStats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		_lastStats.cacheEntries = _cache.size();
+		_lastStats.peakMemory = peak_memory_usage();
+
+		return bestAction;
+	}
+
+public:
+	unsigned int getDepth() const {return _depth;}
+	void setDepth(unsigned int depth) {
+		if(depth == 0) throw std::runtime_error("The search depth must be at least 1.");
+		_depth = depth;
+	}
+
+	float getProbThreshold() const {return _probThreshold;}
+	void setProbThreshold(float probThreshold) {_probThreshold = probThreshold;}
+
+	//! Returns the expected value of the action returned by the last call
+	//! to selectAction().
+	float lastValue() const {return _lastValue;}
+
+	//! Describes the search done by the last call to selectAction().
+	//! The cache entries only count the private transposition table.
+	const SearchRecord& lastStats() const {return _lastStats;}
+
+	//! Makes the player use a transposition table that is kept across
+	//! moves and can be shared with other players, including ones running
+	//! in other threads. Pass nullptr to return to the private table.
+	void setSharedTable(std::shared_ptr<TranspositionTable> table) {
+		_sharedTable = std::move(table);
+		_cache.clear();
+	}
+
+	const std::shared_ptr<TranspositionTable>& getSharedTable() const {return _sharedTable;}
+
+	//! Makes the player take the moves of positions found in the book
+	//! instead of searching them. Pass nullptr to stop using a book.
+	void setOpeningBook(std::shared_ptr<const OpeningBook> book) {_book = std::move(book);}
+	const std::shared_ptr<const OpeningBook>& getOpeningBook() const {return _book;}
+
+public:
+	ExpectimaxPlayer& operator=(const ExpectimaxPlayer&) = default;
+	ExpectimaxPlayer(const ExpectimaxPlayer&) = default;
+
+	//! The depth is the number of moves the search looks ahead.
+	ExpectimaxPlayer(unsigned int depth = 3, float probThreshold = 0.0001f,
+		const Evaluator& evaluator = Evaluator()):
+		_evaluator(evaluator), _depth(1), _probThreshold(probThreshold), _cache(),
+		_sharedTable(), _lastValue(0.0f), _book(), _lastStats(), _counters(nullptr)
+	{
+		setDepth(depth);
+	}
+};
+
+#endif // EXPECTIMAX_PLAYER_H
@@ -71,9 +71,7 @@ void AuxTableBase::init_tables() {
 }
 
 int BoardMethods::count_empty(board_t x) {
-    x |= (x >> 2) & 0x3333333333333333ULL;
-    x |= (x >> 1);
-    x = ~x & 0x1111111111111111ULL;
+    x = empty_mask(x);
     // At this point each nibble is:
     //  0 if the original nibble was non-zero
     //  1 if the original nibble was zero
@@ -85,6 +83,58 @@ int BoardMethods::count_empty(board_t x) {
     return x & 0xf;
 }
 
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(GAME2048_STATIC_BMI2)
+#define GAME2048_BMI2_DISPATCH 1
+#include <immintrin.h>
+#include <cpuid.h>
+
+namespace {
+
+__attribute__((target("bmi,bmi2")))
+AuxTableBase::board_t insert_tile_bmi2(AuxTableBase::board_t board,
+	AuxTableBase::board_t tile, unsigned int index)
+{
+	return board | (tile << _tzcnt_u64(_pdep_u64(
+		AuxTableBase::board_t(1) << index, BoardMethods::empty_mask(board)
+	)));
+}
+
+bool has_fast_bmi2() {
+	__builtin_cpu_init();
+	if(!__builtin_cpu_supports("bmi2")) return false;
+	if(!__builtin_cpu_is("amd")) return true;
+
+	// AMD implements PDEP in microcode up to Zen 2 (family 17h).
+	unsigned int eax, ebx, ecx, edx;
+	if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+	unsigned int family = (eax >> 8) & 0xf;
+	if(family == 0xf) family += (eax >> 20) & 0xff;
+	return family >= 0x19;
+}
+
+} // namespace
+#endif // GAME2048_BMI2_DISPATCH
+
+AuxTableBase::board_t (*BoardMethods::_insert_tile_impl)(board_t, board_t, unsigned int) = BoardMethods::insert_tile_portable;
+
+bool BoardMethods::insert_tile_dispatcher = (select_insert_tile(), true);
+
+void BoardMethods::select_insert_tile() {
+#ifdef GAME2048_BMI2_DISPATCH
+	if(has_fast_bmi2()) _insert_tile_impl = insert_tile_bmi2;
+#endif
+}
+
+bool BoardMethods::uses_bmi2() {
+#if defined(GAME2048_STATIC_BMI2)
+	return true;
+#elif defined(GAME2048_BMI2_DISPATCH)
+	return _insert_tile_impl == insert_tile_bmi2;
+#else
+	return false;
+#endif
+}
+
 //! Returns all possible next states for the specified action along with
 //! their respective probabilities.
 std::vector<std::pair<GameBoard, float> > GameBoard::allNexts(GameAction action) const {
@@ -99,14 +149,14 @@ std::vector<std::pair<GameBoard, float> > GameBoard::allNexts(GameAction action)
 	prob4 /= empty;
 	prob2 /= empty;
 
-	for(unsigned int i = 0; i < empty*2; i+=2) {
+	for(int i = 0; i < empty; i++) {
 		// tile 2
-		nexts[i].first = insert_tile(det_board, 1, i);
-		nexts[i].second = prob2;
+		nexts[2*i].first = insert_tile(det_board, 1, i);
+		nexts[2*i].second = prob2;
 
 		// tile 4
-		nexts[i+1].first = insert_tile(det_board, 2, i);
-		nexts[i+1].second = prob4;
+		nexts[2*i+1].first = insert_tile(det_board, 2, i);
+		nexts[2*i+1].second = prob4;
 	}
 
 	return nexts;
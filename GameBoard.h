@@ -3,11 +3,19 @@
 
 #include "system.h"
 #include <ostream>
+#include <vector>
 #include <unordered_map>
 #include <stdexcept>
 #include <string>
 #include <cmath>
 
+// If the compiler is allowed to assume BMI2 (e.g. -march=haswell),
+// insert_tile uses PDEP/TZCNT directly, bypassing the runtime dispatch.
+#if defined(__BMI__) && defined(__BMI2__)
+#define GAME2048_STATIC_BMI2 1
+#include <immintrin.h>
+#endif
+
 // We could use boost_multiprecision to generalize this to support greater
 // values -- if we do want to achieve the 65536 tile.
 //
@@ -90,6 +98,16 @@ public:
 };
 
 class BoardMethods: public AuxTableBase {
+private:
+	//! The implementation of insert_tile selected at runtime depending
+	//! on whether the CPU has fast BMI2 instructions.
+	static board_t (*_insert_tile_impl)(board_t board, board_t tile, unsigned int index);
+	//! A helper member used to call select_insert_tile.
+	static bool insert_tile_dispatcher;
+
+private:
+	static void select_insert_tile();
+
 public:
 	static float score_helper(board_t board, const float* table) {
 		return table[(board >>  0) & ROW_MASK] +
@@ -117,6 +135,61 @@ public:
 		return b1 | (b2 >> 24) | (b3 << 24);
 	}
 
+	//! Mirrors the board left to right (reverses every row).
+	static inline board_t flip_horizontal(board_t x) {
+		x = ((x & 0x0F0F0F0F0F0F0F0FULL) << 4) | ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL);
+		return ((x & 0x00FF00FF00FF00FFULL) << 8) | ((x >> 8) & 0x00FF00FF00FF00FFULL);
+	}
+
+	//! Mirrors the board top to bottom (reverses the order of the rows).
+	static inline board_t flip_vertical(board_t x) {
+		x = ((x & 0x0000FFFF0000FFFFULL) << 16) | ((x >> 16) & 0x0000FFFF0000FFFFULL);
+		return (x << 32) | (x >> 32);
+	}
+
+	/**
+	 * Applies one of the 8 symmetries of the board. The bits of symmetry
+	 * select, in the order of application: bit 0 flip_horizontal, bit 1
+	 * flip_vertical, bit 2 transpose_board.
+	**/
+	static inline board_t apply_symmetry(board_t board, unsigned int symmetry) {
+		if(symmetry & 1) board = flip_horizontal(board);
+		if(symmetry & 2) board = flip_vertical(board);
+		if(symmetry & 4) board = transpose_board(board);
+		return board;
+	}
+
+	//! Returns the smallest of the 8 symmetric variants of the board; the
+	//! symmetry that maps the board to it is stored into symmetry.
+	static inline board_t canonical_board(board_t board, unsigned int& symmetry) {
+		board_t variants[8];
+		variants[0] = board;
+		variants[1] = flip_horizontal(board);
+		variants[2] = flip_vertical(board);
+		variants[3] = flip_vertical(variants[1]);
+		for(unsigned int i = 0; i < 4; i++) variants[i + 4] = transpose_board(variants[i]);
+
+		symmetry = 0;
+		for(unsigned int i = 1; i < 8; i++) {
+			if(variants[i] < variants[symmetry]) symmetry = i;
+		}
+
+		return variants[symmetry];
+	}
+
+	static inline board_t canonical_board(board_t board) {
+		unsigned int symmetry;
+		return canonical_board(board, symmetry);
+	}
+
+	// Returns a word with the lowest bit set in every nibble that is empty
+	// in the board and all other bits cleared.
+	static inline board_t empty_mask(board_t x) {
+		x |= (x >> 2) & 0x3333333333333333ULL;
+		x |= (x >> 1);
+		return ~x & 0x1111111111111111ULL;
+	}
+
 	// Count the number of empty positions (= zero nibbles) in a board.
 	// Precondition: the board cannot be fully empty.
 	static int count_empty(board_t x);
@@ -152,21 +225,29 @@ public:
 		return (unif_random(100) < PROB4_TIMES_100) ? 2 : 1;
 	}
 
-	static board_t insert_tile(board_t board, board_t tile, unsigned int index) {
-		board_t tmp = board;
-		while (true) {
-		    while ((tmp & 0xf) != 0) {
-		        tmp >>= 4;
-		        tile <<= 4;
-		    }
-		    if (index == 0) break;
-		    --index;
-		    tmp >>= 4;
-		    tile <<= 4;
-		}
-		return board | tile;
+	//! Places the tile into the index-th empty cell of the board.
+	//! Precondition: the board has more than index empty cells.
+	static inline board_t insert_tile(board_t board, board_t tile, unsigned int index) {
+	#ifdef GAME2048_STATIC_BMI2
+		return board | (tile << _tzcnt_u64(_pdep_u64(board_t(1) << index, empty_mask(board))));
+	#else
+		return _insert_tile_impl(board, tile, index);
+	#endif
 	}
 
+	//! A portable implementation of insert_tile: clears the lowest bits
+	//! of the empty mask until the index-th empty cell is the lowest one.
+	static inline board_t insert_tile_portable(board_t board, board_t tile, unsigned int index) {
+		board_t mask = empty_mask(board);
+		for(; index; --index) mask &= mask - 1;
+		return board | (tile * (mask & (~mask + 1)));
+	}
+
+	//! Returns true if insert_tile uses the BMI2 instructions PDEP and
+	//! TZCNT. These are only used if the CPU supports them and PDEP is not
+	//! microcoded (as it is on AMD CPUs before Zen 3).
+	static bool uses_bmi2();
+
 	inline static board_t insert_tile_rand(board_t board, board_t tile) {
 		int index = unif_random(count_empty(board));
 		return insert_tile(board, tile, index);
@@ -220,6 +301,34 @@ public:
 		return ret;
 	}
 
+	//! The results of executing all four moves on a board, indexed
+	//! by GameAction - 1 (that is UP, DOWN, LEFT, RIGHT).
+	struct Afterstates {
+		board_t boards[4];
+		//! Bit i is set iff boards[i] differs from the original board.
+		uint8_t legal;
+	};
+
+	//! Executes all four moves at once. A convenience wrapper: calling the
+	//! execute_* methods inline costs the same, as the compiler shares the
+	//! transpose of the vertical moves anyway.
+	static inline Afterstates execute_all(board_t board) {
+		Afterstates res;
+		res.boards[0] = execute_up(board);
+		res.boards[1] = execute_down(board);
+		res.boards[2] = execute_left(board);
+		res.boards[3] = execute_right(board);
+
+		res.legal = uint8_t(
+			((res.boards[0] != board) << 0) |
+			((res.boards[1] != board) << 1) |
+			((res.boards[2] != board) << 2) |
+			((res.boards[3] != board) << 3)
+		);
+
+		return res;
+	}
+
 	static inline board_t set_element(board_t board, unsigned int row,
 		unsigned int col, unsigned int val)
 	{
@@ -283,6 +392,46 @@ public:
 		return board;
 	}
 
+	/**
+	 * Maps an action on a board to the corresponding action on the board
+	 * transformed by apply_symmetry(board, symmetry): executing the mapped
+	 * action on the transformed board yields the transformed afterstate.
+	**/
+	static inline GameAction transform_action(GameAction action, unsigned int symmetry) {
+		if(symmetry & 1) action = flip_action_horizontal(action);
+		if(symmetry & 2) action = flip_action_vertical(action);
+		if(symmetry & 4) action = transpose_action(action);
+		return action;
+	}
+
+	//! The inverse of transform_action.
+	static inline GameAction inverse_transform_action(GameAction action, unsigned int symmetry) {
+		if(symmetry & 4) action = transpose_action(action);
+		if(symmetry & 2) action = flip_action_vertical(action);
+		if(symmetry & 1) action = flip_action_horizontal(action);
+		return action;
+	}
+
+private:
+	static inline GameAction flip_action_horizontal(GameAction action) {
+		return (action == LEFT) ? RIGHT : (action == RIGHT) ? LEFT : action;
+	}
+
+	static inline GameAction flip_action_vertical(GameAction action) {
+		return (action == UP) ? DOWN : (action == DOWN) ? UP : action;
+	}
+
+	static inline GameAction transpose_action(GameAction action) {
+		switch(action) {
+		case UP: return LEFT;
+		case LEFT: return UP;
+		case DOWN: return RIGHT;
+		case RIGHT: return DOWN;
+		case None: return None;
+		default: return action;
+		}
+	}
+
 public:
 	inline int emptyCount() const {return count_empty(_board);}
 	inline int maxRank() const {return max_rank(_board);}
@@ -0,0 +1,98 @@
+#ifndef MOVE_PROTOCOL_H
+#define MOVE_PROTOCOL_H
+
+#include <cstdint>
+
+/**
+ * The binary protocol spoken by MoveServer over a Unix domain socket.
+ * All fields are in host byte order, since both ends run on the same
+ * machine.
+ *
+ * A client sends a RequestHeader optionally followed by a payload:
+ *  - QUERY: count board_t values (uint64_t, packed as in GameBoard);
+ *  - STATS: no payload, count must be 0.
+ *
+ * The server answers with a ResponseHeader carrying the id of the
+ * request, followed by:
+ *  - QUERY: count MoveResult structures, one for every queried board,
+ *    in the order of the request;
+ *  - STATS: a StatsHeader followed by count uint64_t latency histogram
+ *    buckets; bucket i counts requests answered in [2^i, 2^(i+1)) us
+ *    (bucket 0 also includes anything faster). The search counters of the
+ *    StatsHeader are those of aggregate_search_counters(); they are all 0
+ *    if the server was built without search stats.
+ *
+ * Responses to requests sent over the same connection without waiting for
+ * the answers may arrive out of order; use the ids to match them up.
+ * On a malformed request the server answers with a non-OK status and
+ * closes the connection.
+**/
+namespace move_protocol {
+
+constexpr uint32_t MAGIC = 0x51324d47; // "GM2Q"
+//! The maximum number of boards in a single request.
+constexpr uint32_t MAX_BOARDS = 1 << 20;
+
+enum RequestType: uint16_t {
+	QUERY = 1,
+	STATS = 2
+};
+
+enum Status: uint16_t {
+	OK = 0,
+	BAD_MAGIC = 1,
+	BAD_TYPE = 2,
+	BAD_COUNT = 3
+};
+
+struct RequestHeader {
+	uint32_t magic;
+	uint16_t type;
+	uint16_t reserved;
+	uint32_t id;
+	uint32_t count;
+};
+
+struct ResponseHeader {
+	uint32_t magic;
+	uint16_t type;
+	uint16_t status;
+	uint32_t id;
+	uint32_t count;
+};
+
+struct MoveResult {
+	//! The expected value of the best move.
+	float value;
+	//! The best move as a GameBoard::GameAction; None if the game is over.
+	uint8_t action;
+	uint8_t reserved[3];
+};
+
+struct StatsHeader {
+	uint64_t requests;
+	uint64_t boards;
+	uint64_t searches;
+	//! Latency percentiles in microseconds (upper bounds of the buckets).
+	uint64_t p50_us;
+	uint64_t p90_us;
+	uint64_t p99_us;
+	uint64_t p999_us;
+	uint64_t max_us;
+	//! The search counters summed up over all searches and plies.
+	uint64_t max_nodes;
+	uint64_t chance_nodes;
+	uint64_t evaluations;
+	uint64_t cache_lookups;
+	uint64_t cache_hits;
+	uint64_t pruned_branches;
+};
+
+static_assert(sizeof(RequestHeader) == 16, "Unexpected padding in RequestHeader.");
+static_assert(sizeof(ResponseHeader) == 16, "Unexpected padding in ResponseHeader.");
+static_assert(sizeof(MoveResult) == 8, "Unexpected padding in MoveResult.");
+static_assert(sizeof(StatsHeader) == 112, "Unexpected padding in StatsHeader.");
+
+} // namespace move_protocol
+
+#endif // MOVE_PROTOCOL_H
@@ -0,0 +1,464 @@
+#include "MoveServer.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace move_protocol;
+
+struct MoveServer::Connection {
+	int fd;
+
+	std::mutex mutex;
+	std::condition_variable cond;
+	//! The responses waiting to be written by the writer thread.
+	std::deque<std::vector<char> > output;
+	//! The number of requests read whose responses have not been written
+	//! (or dropped) yet.
+	unsigned int pending;
+	//! Set once the reader thread stops reading requests.
+	bool readerDone;
+	//! Set by stop(): the writer drops everything and exits.
+	bool closing;
+
+	std::thread reader;
+	std::thread writer;
+	//! Set once both threads are about to exit.
+	std::atomic<bool> done;
+
+	Connection& operator=(const Connection&) = delete;
+	Connection(const Connection&) = delete;
+	explicit Connection(int fd_): fd(fd_), mutex(), cond(), output(), pending(0),
+		readerDone(false), closing(false), reader(), writer(), done(false) {}
+	~Connection() {close(fd);}
+};
+
+namespace {
+
+bool read_fully(int fd, void* buf, std::size_t n) {
+	char* ptr = static_cast<char*>(buf);
+	while(n > 0) {
+		ssize_t r = read(fd, ptr, n);
+		if(r < 0 && errno == EINTR) continue;
+		if(r <= 0) return false;
+		ptr += r; n -= r;
+	}
+	return true;
+}
+
+bool write_fully(int fd, const void* buf, std::size_t n) {
+	const char* ptr = static_cast<const char*>(buf);
+	while(n > 0) {
+		// MSG_NOSIGNAL: a client that went away must not kill the server.
+		ssize_t r = send(fd, ptr, n, MSG_NOSIGNAL);
+		if(r < 0 && errno == EINTR) continue;
+		if(r <= 0) return false;
+		ptr += r; n -= r;
+	}
+	return true;
+}
+
+template<class T>
+void append(std::vector<char>& buffer, const T* data, std::size_t count = 1) {
+	const char* ptr = reinterpret_cast<const char*>(data);
+	buffer.insert(buffer.end(), ptr, ptr + count * sizeof(T));
+}
+
+std::string errno_message(const std::string& what) {
+	return what + ": " + std::strerror(errno) + ".";
+}
+
+} // namespace
+
+/*******************************************************************************
+ * LatencyHistogram
+*******************************************************************************/
+
+void MoveServer::LatencyHistogram::record(uint64_t us) {
+	unsigned int bucket = 0;
+	while((us >> (bucket + 1)) && bucket + 1 < NUM_BUCKETS) bucket++;
+	_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+
+	uint64_t prev = _max.load(std::memory_order_relaxed);
+	while(prev < us && !_max.compare_exchange_weak(prev, us, std::memory_order_relaxed));
+}
+
+void MoveServer::LatencyHistogram::snapshot(uint64_t* buckets) const {
+	for(unsigned int i = 0; i < NUM_BUCKETS; i++) {
+		buckets[i] = _buckets[i].load(std::memory_order_relaxed);
+	}
+}
+
+uint64_t MoveServer::LatencyHistogram::percentile(const uint64_t* buckets, double q) {
+	uint64_t total = 0;
+	for(unsigned int i = 0; i < NUM_BUCKETS; i++) total += buckets[i];
+	if(total == 0) return 0;
+
+	uint64_t target = std::max<uint64_t>(1, uint64_t(std::ceil(q * total)));
+	uint64_t cumulative = 0;
+	for(unsigned int i = 0; i < NUM_BUCKETS; i++) {
+		cumulative += buckets[i];
+		if(cumulative >= target) return uint64_t(1) << (i + 1);
+	}
+
+	return uint64_t(1) << NUM_BUCKETS;
+}
+
+MoveServer::LatencyHistogram::LatencyHistogram(): _max(0) {
+	for(auto& bucket: _buckets) bucket.store(0);
+}
+
+/*******************************************************************************
+ * MoveServer
+*******************************************************************************/
+
+MoveServer::Job::Job(std::shared_ptr<Connection> connection_, uint32_t id_, uint32_t count):
+	connection(std::move(connection_)), id(id_), boards(count), results(count),
+	remaining(count), received(clock::now()) {}
+
+void MoveServer::start() {
+	if(_listenFd >= 0) throw std::runtime_error("The server is already running.");
+
+	sockaddr_un addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(_options.socketPath.size() >= sizeof(addr.sun_path)) {
+		throw std::runtime_error("The socket path '" + _options.socketPath + "' is too long.");
+	}
+	std::strcpy(addr.sun_path, _options.socketPath.c_str());
+
+	// Remove a stale socket left behind by a previous run, but never
+	// anything that is not a socket.
+	struct stat st;
+	if(lstat(addr.sun_path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(addr.sun_path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd < 0) throw std::runtime_error(errno_message("Cannot create the socket"));
+
+	if(bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 64) < 0) {
+		std::string msg = errno_message("Cannot listen on '" + _options.socketPath + "'");
+		close(fd);
+		throw std::runtime_error(msg);
+	}
+
+	_listenFd = fd;
+	_stopping = false;
+
+	unsigned int threads = _options.threads;
+	if(threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+	for(unsigned int i = 0; i < threads; i++) {
+		_workers.emplace_back(&MoveServer::workerLoop, this);
+	}
+
+	_acceptThread = std::thread(&MoveServer::acceptLoop, this);
+}
+
+void MoveServer::stop() {
+	if(_listenFd < 0) return;
+	_stopping = true;
+
+	// Wakes up the blocking accept().
+	shutdown(_listenFd, SHUT_RDWR);
+	_acceptThread.join();
+	close(_listenFd);
+	_listenFd = -1;
+	unlink(_options.socketPath.c_str());
+
+	{
+		std::lock_guard<std::mutex> lock(_connectionsMutex);
+		for(auto& connection: _connections) {
+			shutdown(connection->fd, SHUT_RDWR);
+
+			std::lock_guard<std::mutex> connectionLock(connection->mutex);
+			connection->closing = true;
+			connection->cond.notify_all();
+		}
+	}
+
+	for(auto& connection: _connections) {
+		connection->reader.join();
+		connection->writer.join();
+	}
+	_connections.clear();
+
+	{
+		std::lock_guard<std::mutex> lock(_queueMutex);
+		_queue.clear();
+	}
+
+	_queueCond.notify_all();
+	for(auto& worker: _workers) worker.join();
+	_workers.clear();
+}
+
+void MoveServer::acceptLoop() {
+	while(!_stopping) {
+		int fd = accept(_listenFd, nullptr, nullptr);
+		if(fd < 0) {
+			if(_stopping) break;
+			if(errno == EINTR || errno == ECONNABORTED) continue;
+			if(errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+				// Out of resources: wait for some connections to close.
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				continue;
+			}
+			break;
+		}
+
+		auto connection = std::make_shared<Connection>(fd);
+
+		std::lock_guard<std::mutex> lock(_connectionsMutex);
+
+		// Reap the connections whose clients have already gone away.
+		for(auto iter = _connections.begin(); iter != _connections.end();) {
+			if((*iter)->done) {
+				(*iter)->reader.join();
+				(*iter)->writer.join();
+				iter = _connections.erase(iter);
+			} else {
+				++iter;
+			}
+		}
+
+		_connections.push_back(connection);
+		connection->reader = std::thread(&MoveServer::readLoop, this, connection);
+		connection->writer = std::thread(&MoveServer::writeLoop, this, connection);
+	}
+}
+
+void MoveServer::readLoop(std::shared_ptr<Connection> connection) {
+	RequestHeader header;
+
+	while(read_fully(connection->fd, &header, sizeof(header))) {
+		{
+			// Wait until the client reads some of its responses.
+			std::unique_lock<std::mutex> lock(connection->mutex);
+			connection->cond.wait(lock, [&]{
+				return connection->closing || connection->pending < _options.maxPending;
+			});
+			if(connection->closing) break;
+			connection->pending++;
+		}
+
+		Status status = OK;
+
+		if(header.magic != MAGIC) {
+			status = BAD_MAGIC;
+		} else if(header.type == QUERY) {
+			if(header.count > MAX_BOARDS) {
+				status = BAD_COUNT;
+			} else {
+				auto job = std::make_shared<Job>(connection, header.id, header.count);
+				if(!read_fully(connection->fd, job->boards.data(), header.count * sizeof(board_t))) {
+					std::lock_guard<std::mutex> lock(connection->mutex);
+					connection->pending--;
+					break;
+				}
+
+				if(header.count == 0) finish(*job);
+				else enqueue(job);
+			}
+		} else if(header.type == STATS) {
+			if(header.count != 0) status = BAD_COUNT;
+			else sendStats(*connection, header.id);
+		} else {
+			status = BAD_TYPE;
+		}
+
+		if(status != OK) {
+			ResponseHeader response{MAGIC, header.type, status, header.id, 0};
+			std::vector<char> buffer;
+			append(buffer, &response);
+			respond(*connection, std::move(buffer));
+			break;
+		}
+	}
+
+	shutdown(connection->fd, SHUT_RD);
+
+	std::lock_guard<std::mutex> lock(connection->mutex);
+	connection->readerDone = true;
+	connection->cond.notify_all();
+}
+
+void MoveServer::writeLoop(std::shared_ptr<Connection> connection) {
+	// Set once a write fails; the remaining responses are dropped.
+	bool broken = false;
+	std::unique_lock<std::mutex> lock(connection->mutex);
+
+	while(true) {
+		// Keep going until the responses to all requests that have been
+		// read are written, even if the client has stopped sending.
+		connection->cond.wait(lock, [&]{
+			return connection->closing || !connection->output.empty() ||
+				(connection->readerDone && connection->pending == 0);
+		});
+
+		if(connection->closing || connection->output.empty()) break;
+
+		std::vector<char> response = std::move(connection->output.front());
+		connection->output.pop_front();
+
+		lock.unlock();
+		if(!broken && !write_fully(connection->fd, response.data(), response.size())) {
+			// Also wakes up the reader blocked in read().
+			shutdown(connection->fd, SHUT_RDWR);
+			broken = true;
+		}
+		lock.lock();
+
+		connection->pending--;
+		connection->cond.notify_all();
+	}
+
+	// Anything left over is dropped along with the connection.
+	connection->output.clear();
+	lock.unlock();
+
+	// Lets the client see the end of the stream right away; the socket
+	// itself is only closed once the connection gets reaped.
+	shutdown(connection->fd, SHUT_RDWR);
+	connection->done = true;
+}
+
+void MoveServer::respond(Connection& connection, std::vector<char> response) {
+	std::lock_guard<std::mutex> lock(connection.mutex);
+	connection.output.push_back(std::move(response));
+	connection.cond.notify_all();
+}
+
+void MoveServer::enqueue(const std::shared_ptr<Job>& job) {
+	{
+		std::lock_guard<std::mutex> lock(_queueMutex);
+		for(uint32_t i = 0; i < job->boards.size(); i++) {
+			_queue.push_back(WorkItem{job, i});
+		}
+	}
+
+	_queueCond.notify_all();
+}
+
+void MoveServer::workerLoop() {
+	ExpectimaxPlayer<> player(_options.depth, _options.probThreshold);
+	player.setSharedTable(_table);
+	player.setOpeningBook(_book);
+
+	std::vector<WorkItem> batch;
+	batch.reserve(_options.batchSize);
+
+	while(true) {
+		{
+			std::unique_lock<std::mutex> lock(_queueMutex);
+			_queueCond.wait(lock, [this]{return _stopping || !_queue.empty();});
+			if(_stopping) return;
+
+			std::size_t n = std::min<std::size_t>(_options.batchSize, _queue.size());
+			std::move(_queue.begin(), _queue.begin() + n, std::back_inserter(batch));
+			_queue.erase(_queue.begin(), _queue.begin() + n);
+		}
+
+		// Group identical boards -- possibly of different clients --
+		// so that each of them is only searched once.
+		std::sort(batch.begin(), batch.end(), [](const WorkItem& a, const WorkItem& b) {
+			return a.job->boards[a.index] < b.job->boards[b.index];
+		});
+
+		for(std::size_t begin = 0; begin < batch.size();) {
+			board_t board = batch[begin].job->boards[batch[begin].index];
+
+			MoveResult result;
+			std::memset(&result, 0, sizeof(result));
+
+			try {
+				result.action = player.selectAction(GameBoard(board));
+				result.value = player.lastValue();
+			} catch(IllegalAction&) {
+				result.action = GameBoard::None;
+			}
+
+			_numSearches.fetch_add(1, std::memory_order_relaxed);
+
+			std::size_t end = begin;
+			for(; end < batch.size() && batch[end].job->boards[batch[end].index] == board; end++) {
+				Job& job = *batch[end].job;
+				job.results[batch[end].index] = result;
+				if(job.remaining.fetch_sub(1) == 1) finish(job);
+			}
+
+			begin = end;
+		}
+
+		batch.clear();
+	}
+}
+
+void MoveServer::finish(Job& job) {
+	auto us = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - job.received).count();
+	_latencies.record(uint64_t(us));
+	_numRequests.fetch_add(1, std::memory_order_relaxed);
+	_numBoards.fetch_add(job.boards.size(), std::memory_order_relaxed);
+
+	ResponseHeader response{MAGIC, QUERY, OK, job.id, uint32_t(job.results.size())};
+
+	std::vector<char> buffer;
+	buffer.reserve(sizeof(response) + job.results.size() * sizeof(MoveResult));
+	append(buffer, &response);
+	append(buffer, job.results.data(), job.results.size());
+	respond(*job.connection, std::move(buffer));
+}
+
+void MoveServer::sendStats(Connection& connection, uint32_t id) {
+	uint64_t buckets[LatencyHistogram::NUM_BUCKETS];
+	_latencies.snapshot(buckets);
+
+	StatsHeader stats;
+	stats.requests = _numRequests.load(std::memory_order_relaxed);
+	stats.boards = _numBoards.load(std::memory_order_relaxed);
+	stats.searches = _numSearches.load(std::memory_order_relaxed);
+	stats.p50_us = LatencyHistogram::percentile(buckets, 0.5);
+	stats.p90_us = LatencyHistogram::percentile(buckets, 0.9);
+	stats.p99_us = LatencyHistogram::percentile(buckets, 0.99);
+	stats.p999_us = LatencyHistogram::percentile(buckets, 0.999);
+	stats.max_us = _latencies.max();
+
+	SearchCounters counters = aggregate_search_counters();
+	stats.max_nodes = counters.nodes() - counters.chanceNodes();
+	stats.chance_nodes = counters.chanceNodes();
+	stats.evaluations = counters.evaluations();
+	stats.cache_lookups = counters.cacheLookups();
+	stats.cache_hits = counters.cacheHits();
+	stats.pruned_branches = counters.prunedBranches();
+
+	ResponseHeader response{MAGIC, STATS, OK, id, LatencyHistogram::NUM_BUCKETS};
+
+	std::vector<char> buffer;
+	append(buffer, &response);
+	append(buffer, &stats);
+	append(buffer, buckets, LatencyHistogram::NUM_BUCKETS);
+	respond(connection, std::move(buffer));
+}
+
+MoveServer::MoveServer(const Options& options):
+	_options(options),
+	_table(std::make_shared<TranspositionTable>(options.tableSizeLog2)),
+	_book(options.bookPath.empty() ? nullptr : std::make_shared<const OpeningBook>(options.bookPath)),
+	_listenFd(-1), _stopping(false), _acceptThread(), _workers(),
+	_connectionsMutex(), _connections(), _queueMutex(), _queueCond(), _queue(),
+	_latencies(), _numRequests(0), _numBoards(0), _numSearches(0)
+{
+	if(_options.depth == 0) throw std::runtime_error("The search depth must be at least 1.");
+	if(_options.batchSize == 0) throw std::runtime_error("The batch size must be at least 1.");
+	if(_options.maxPending == 0) throw std::runtime_error("The maximum number of pending requests must be at least 1.");
+}
+
+MoveServer::~MoveServer() {
+	stop();
+}
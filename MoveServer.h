@@ -0,0 +1,160 @@
+#ifndef MOVE_SERVER_H
+#define MOVE_SERVER_H
+
+#include "MoveProtocol.h"
+#include "ExpectimaxPlayer.h"
+#include "TranspositionTable.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * A local server answering best-move queries over a Unix domain socket
+ * (see MoveProtocol.h for the wire format).
+ *
+ * Every connection is served by its own reader thread, which splits each
+ * request into boards and puts them on a common queue. A pool of worker
+ * threads takes the boards off the queue in batches, so that concurrent
+ * requests of several clients get coalesced, and searches every distinct
+ * board of a batch once. All workers share a single transposition table
+ * that stays warm for the whole lifetime of the server.
+ *
+ * Once all boards of a request have been answered, the response is handed
+ * to the writer thread of the connection, so workers never block on a
+ * client that does not read its responses. Such a client cannot make the
+ * server buffer an unbounded amount of work either: once it has
+ * maxPending requests without written responses, its connection is not
+ * read from until some of them get written.
+**/
+class MoveServer {
+public:
+	typedef GameBoard::board_t board_t;
+	typedef std::chrono::steady_clock clock;
+
+	struct Options {
+		std::string socketPath;
+		//! The number of worker threads; 0 means one per hardware thread.
+		unsigned int threads;
+		//! The depth of the expectimax search.
+		unsigned int depth;
+		//! The probability threshold of the expectimax search.
+		float probThreshold;
+		//! The transposition table has 2^tableSizeLog2 slots.
+		unsigned int tableSizeLog2;
+		//! The maximum number of boards a worker takes off the queue at once.
+		unsigned int batchSize;
+		//! The maximum number of requests of a connection whose responses
+		//! have not been written yet.
+		unsigned int maxPending;
+		//! An opening book to consult before searching; none if empty.
+		std::string bookPath;
+
+		Options(): socketPath(), threads(0), depth(3), probThreshold(0.0001f),
+			tableSizeLog2(24), batchSize(64), maxPending(16), bookPath() {}
+	};
+
+	//! A histogram of request latencies with power-of-two buckets.
+	class LatencyHistogram {
+	public:
+		static constexpr unsigned int NUM_BUCKETS = 32;
+
+	private:
+		std::atomic<uint64_t> _buckets[NUM_BUCKETS];
+		std::atomic<uint64_t> _max;
+
+	public:
+		void record(uint64_t us);
+		//! Fills in the counts of all the buckets; buckets must have room
+		//! for NUM_BUCKETS values.
+		void snapshot(uint64_t* buckets) const;
+		//! Returns the upper bound of the bucket containing the quantile q.
+		static uint64_t percentile(const uint64_t* buckets, double q);
+		uint64_t max() const {return _max.load(std::memory_order_relaxed);}
+
+	public:
+		LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+		LatencyHistogram(const LatencyHistogram&) = delete;
+		LatencyHistogram();
+	};
+
+private:
+	struct Connection;
+
+	//! A single query request in progress.
+	struct Job {
+		std::shared_ptr<Connection> connection;
+		uint32_t id;
+		std::vector<board_t> boards;
+		std::vector<move_protocol::MoveResult> results;
+		std::atomic<uint32_t> remaining;
+		clock::time_point received;
+
+		Job& operator=(const Job&) = delete;
+		Job(const Job&) = delete;
+		Job(std::shared_ptr<Connection> connection_, uint32_t id_, uint32_t count);
+	};
+
+	struct WorkItem {
+		std::shared_ptr<Job> job;
+		uint32_t index;
+	};
+
+private:
+	Options _options;
+	std::shared_ptr<TranspositionTable> _table;
+	std::shared_ptr<const OpeningBook> _book;
+	int _listenFd;
+
+	std::atomic<bool> _stopping;
+	std::thread _acceptThread;
+	std::vector<std::thread> _workers;
+
+	std::mutex _connectionsMutex;
+	std::list<std::shared_ptr<Connection> > _connections;
+
+	std::mutex _queueMutex;
+	std::condition_variable _queueCond;
+	std::deque<WorkItem> _queue;
+
+	LatencyHistogram _latencies;
+	std::atomic<uint64_t> _numRequests;
+	std::atomic<uint64_t> _numBoards;
+	std::atomic<uint64_t> _numSearches;
+
+private:
+	void acceptLoop();
+	void readLoop(std::shared_ptr<Connection> connection);
+	void writeLoop(std::shared_ptr<Connection> connection);
+	void workerLoop();
+
+	void enqueue(const std::shared_ptr<Job>& job);
+	void finish(Job& job);
+	void sendStats(Connection& connection, uint32_t id);
+	//! Hands a response over to the writer thread of the connection.
+	void respond(Connection& connection, std::vector<char> response);
+
+public:
+	//! Binds the socket and starts all the threads.
+	void start();
+	//! Stops accepting connections, closes all existing connections and
+	//! joins all the threads. Queued requests are dropped.
+	void stop();
+
+	const Options& options() const {return _options;}
+
+public:
+	MoveServer& operator=(const MoveServer&) = delete;
+	MoveServer(const MoveServer&) = delete;
+
+	explicit MoveServer(const Options& options);
+	~MoveServer();
+};
+
+#endif // MOVE_SERVER_H
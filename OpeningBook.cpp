@@ -0,0 +1,163 @@
+#include "OpeningBook.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define GAME2048_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char BOOK_MAGIC[8] = {'G', '2', '0', '4', '8', 'B', 'K', '\0'};
+
+//! The number of interpolation steps before falling back to binary search.
+constexpr unsigned int MAX_INTERPOLATION_STEPS = 8;
+
+} // namespace
+
+const OpeningBook::Entry* OpeningBook::find(board_t board) const {
+	if(_count == 0) return nullptr;
+
+	std::size_t lo = 0, hi = _count - 1;
+
+	for(unsigned int step = 0; step < MAX_INTERPOLATION_STEPS; step++) {
+		board_t lowKey = _entries[lo].board, highKey = _entries[hi].board;
+		if(board < lowKey || board > highKey) return nullptr;
+		if(lowKey == highKey) break;
+
+		// Guess the position assuming the keys are spread evenly in [lo, hi].
+		double fraction = double(board - lowKey) / double(highKey - lowKey);
+		std::size_t pos = lo + std::size_t(fraction * (hi - lo));
+		pos = std::min(std::max(pos, lo), hi);
+
+		board_t key = _entries[pos].board;
+		if(key == board) return &_entries[pos];
+		if(key < board) lo = pos + 1;
+		else if(pos == 0) return nullptr;
+		else hi = pos - 1;
+
+		if(lo > hi) return nullptr;
+	}
+
+	auto iter = std::lower_bound(_entries + lo, _entries + hi + 1, board,
+		[](const Entry& entry, board_t key) {return entry.board < key;});
+	if(iter == _entries + hi + 1 || iter->board != board) return nullptr;
+	return iter;
+}
+
+bool OpeningBook::lookup(board_t board, GameBoard::GameAction& action, float& value) const {
+	unsigned int symmetry;
+	const Entry* entry = find(BoardMethods::canonical_board(board, symmetry));
+	if(!entry) return false;
+
+	action = GameBoard::inverse_transform_action(GameBoard::GameAction(entry->action), symmetry);
+	value = entry->value;
+	return true;
+}
+
+void OpeningBook::write(const std::string& path, std::vector<Entry> entries, uint32_t depth) {
+	std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {return a.board < b.board;});
+
+	Header header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, BOOK_MAGIC, sizeof(header.magic));
+	header.version = VERSION;
+	header.depth = depth;
+	header.count = entries.size();
+
+	// Readers may have the old book mapped: truncating it in place would
+	// pull the pages from under them (SIGBUS), so the new book is written
+	// aside and renamed over the old one, which stays intact for them.
+	std::string tmpPath = path + ".tmp";
+	{
+		std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(Entry));
+		file.close();
+
+		if(!file) {
+			std::remove(tmpPath.c_str());
+			throw std::runtime_error("Cannot write the opening book '" + tmpPath + "'.");
+		}
+	}
+
+#ifndef GAME2048_HAVE_MMAP
+	// rename() does not replace an existing file everywhere (Windows).
+	std::remove(path.c_str());
+#endif
+
+	if(std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+		std::string msg = "Cannot rename '" + tmpPath + "' to '" + path + "': " + std::strerror(errno) + ".";
+		std::remove(tmpPath.c_str());
+		throw std::runtime_error(msg);
+	}
+}
+
+OpeningBook::OpeningBook(const std::string& path):
+	_entries(nullptr), _count(0), _depth(0), _mapping(nullptr), _mappingSize(0), _buffer()
+{
+	const char* data = nullptr;
+	std::size_t size = 0;
+
+#ifdef GAME2048_HAVE_MMAP
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0) throw std::runtime_error("Cannot open the opening book '" + path + "': " + std::strerror(errno) + ".");
+
+	struct stat st;
+	if(fstat(fd, &st) == 0 && st.st_size > 0) {
+		_mappingSize = st.st_size;
+		_mapping = mmap(nullptr, _mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+		if(_mapping == MAP_FAILED) _mapping = nullptr;
+	}
+	close(fd);
+
+	if(!_mapping) throw std::runtime_error("Cannot map the opening book '" + path + "'.");
+	data = static_cast<const char*>(_mapping);
+	size = _mappingSize;
+#else
+	std::ifstream file(path, std::ios::binary);
+	_buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	if(!file && !file.eof()) throw std::runtime_error("Cannot read the opening book '" + path + "'.");
+	data = _buffer.data();
+	size = _buffer.size();
+#endif
+
+	Header header;
+	if(size < sizeof(header)) {
+		release();
+		throw std::runtime_error("The opening book '" + path + "' is truncated.");
+	}
+	std::memcpy(&header, data, sizeof(header));
+
+	if(std::memcmp(header.magic, BOOK_MAGIC, sizeof(header.magic)) != 0 || header.version != VERSION ||
+	   (size - sizeof(header)) / sizeof(Entry) < header.count)
+	{
+		release();
+		throw std::runtime_error("The file '" + path + "' is not a valid opening book.");
+	}
+
+	_entries = reinterpret_cast<const Entry*>(data + sizeof(header));
+	_count = header.count;
+	_depth = header.depth;
+}
+
+void OpeningBook::release() {
+#ifdef GAME2048_HAVE_MMAP
+	if(_mapping) munmap(_mapping, _mappingSize);
+#endif
+	_mapping = nullptr;
+	_buffer.clear();
+}
+
+OpeningBook::~OpeningBook() {
+	release();
+}
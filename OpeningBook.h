@@ -0,0 +1,81 @@
+#ifndef OPENING_BOOK_H
+#define OPENING_BOOK_H
+
+#include "GameBoard.h"
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/**
+ * A read-only table of precomputed best moves for early-game positions,
+ * stored on disk and memory-mapped.
+ *
+ * Positions are keyed on their canonical board (see
+ * BoardMethods::canonical_board), so that all 8 symmetric variants of a
+ * position share a single entry; the stored action refers to the
+ * canonical board and is mapped back on lookup.
+ *
+ * The file consists of a Header followed by the entries sorted by board.
+ * Lookups use interpolation search, falling back to binary search if the
+ * keys turn out to be too unevenly spread for it to converge quickly.
+**/
+class OpeningBook {
+public:
+	typedef GameBoard::board_t board_t;
+
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		//! The depth of the searches used to compute the entries.
+		uint32_t depth;
+		uint64_t count;
+	};
+
+	struct Entry {
+		board_t board;
+		float value;
+		uint8_t action;
+		uint8_t reserved[3];
+	};
+
+	static_assert(sizeof(Header) == 24, "Unexpected padding in OpeningBook::Header.");
+	static_assert(sizeof(Entry) == 16, "Unexpected padding in OpeningBook::Entry.");
+
+	static constexpr uint32_t VERSION = 1;
+
+private:
+	const Entry* _entries;
+	std::size_t _count;
+	uint32_t _depth;
+
+	void* _mapping;
+	std::size_t _mappingSize;
+	//! Used instead of the mapping where mmap is not available.
+	std::vector<char> _buffer;
+
+private:
+	const Entry* find(board_t board) const;
+	void release();
+
+public:
+	//! Looks up the position. On success stores the best action for the
+	//! board (not for its canonical variant) and its value.
+	bool lookup(board_t board, GameBoard::GameAction& action, float& value) const;
+
+	std::size_t size() const {return _count;}
+	uint32_t depth() const {return _depth;}
+
+	//! Sorts the entries, which must hold canonical boards and actions
+	//! relative to them, and writes them into a book file.
+	static void write(const std::string& path, std::vector<Entry> entries, uint32_t depth);
+
+public:
+	OpeningBook& operator=(const OpeningBook&) = delete;
+	OpeningBook(const OpeningBook&) = delete;
+
+	//! Opens a book file; throws std::runtime_error if it is not valid.
+	explicit OpeningBook(const std::string& path);
+	~OpeningBook();
+};
+
+#endif // OPENING_BOOK_H
@@ -0,0 +1,146 @@
+#include "SearchStats.h"
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+//! Keeps track of the counters of all threads.
+struct CounterRegistry {
+	std::mutex mutex;
+	std::vector<const ThreadSearchCounters*> live;
+	//! The sum of the counters of the threads that have exited.
+	SearchCounters retired;
+
+	CounterRegistry(): mutex(), live(), retired() {}
+};
+
+CounterRegistry& registry() {
+	// Never destroyed, so that threads exiting after main() can still
+	// unregister their counters.
+	static CounterRegistry* reg = new CounterRegistry();
+	return *reg;
+}
+
+} // namespace
+
+/*******************************************************************************
+ * SearchCounters
+*******************************************************************************/
+
+uint64_t SearchCounters::nodes() const {
+	uint64_t sum = chanceNodes();
+	for(unsigned int ply = 0; ply < MAX_PLIES; ply++) sum += maxNodes(ply);
+	return sum;
+}
+
+SearchCounters& SearchCounters::operator+=(const SearchCounters& obj) {
+	for(unsigned int i = 0; i < NUM_SEARCH_COUNTERS; i++) values[i] += obj.values[i];
+	return *this;
+}
+
+SearchCounters& SearchCounters::operator-=(const SearchCounters& obj) {
+	for(unsigned int i = 0; i < NUM_SEARCH_COUNTERS; i++) values[i] -= obj.values[i];
+	return *this;
+}
+
+SearchCounters::SearchCounters(): values() {}
+
+/*******************************************************************************
+ * ThreadSearchCounters
+*******************************************************************************/
+
+SearchCounters ThreadSearchCounters::snapshot() const {
+	SearchCounters counters;
+	for(unsigned int i = 0; i < NUM_SEARCH_COUNTERS; i++) {
+		counters.values[i] = _values[i].load(std::memory_order_relaxed);
+	}
+	return counters;
+}
+
+ThreadSearchCounters::ThreadSearchCounters() {
+	for(auto& value: _values) value.store(0, std::memory_order_relaxed);
+
+	auto& reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	reg.live.push_back(this);
+}
+
+ThreadSearchCounters::~ThreadSearchCounters() {
+	auto& reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	reg.retired += snapshot();
+	reg.live.erase(std::remove(reg.live.begin(), reg.live.end(), this), reg.live.end());
+}
+
+ThreadSearchCounters& thread_search_counters() {
+	thread_local ThreadSearchCounters counters;
+	return counters;
+}
+
+SearchCounters aggregate_search_counters() {
+	auto& reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+
+	SearchCounters sum = reg.retired;
+	for(auto counters: reg.live) sum += counters->snapshot();
+	return sum;
+}
+
+/*******************************************************************************
+ * SearchRecord
+*******************************************************************************/
+
+double SearchRecord::branchingFactor() const {
+	uint64_t nodes = counters.nodes() + counters.evaluations();
+	if(depth == 0 || nodes == 0) return 0;
+	return std::pow(double(nodes), 1.0 / depth);
+}
+
+void write_csv_header(std::ostream& os) {
+	os << "move,action,depth,seconds,nodes,chance_nodes,evaluations,"
+		"cache_lookups,cache_hits,pruned_branches,branching_factor,"
+		"cache_entries,peak_memory,book_hit";
+	for(unsigned int ply = 0; ply < SearchCounters::MAX_PLIES; ply++) {
+		os << ",max_nodes_" << ply;
+	}
+	os << "\n";
+}
+
+void write_csv(std::ostream& os, unsigned int move, unsigned int action, const SearchRecord& record) {
+	const SearchCounters& c = record.counters;
+
+	os << move << ',' << action << ',' << record.depth << ',' << record.seconds << ','
+		<< c.nodes() << ',' << c.chanceNodes() << ',' << c.evaluations() << ','
+		<< c.cacheLookups() << ',' << c.cacheHits() << ',' << c.prunedBranches() << ','
+		<< record.branchingFactor() << ',' << record.cacheEntries << ',' << record.peakMemory
+		<< ',' << record.bookHit;
+	for(unsigned int ply = 0; ply < SearchCounters::MAX_PLIES; ply++) {
+		os << ',' << c.maxNodes(ply);
+	}
+	os << "\n";
+}
+
+void write_json(std::ostream& os, unsigned int move, unsigned int action, const SearchRecord& record) {
+	const SearchCounters& c = record.counters;
+
+	os << "{\"move\": " << move << ", \"action\": " << action
+		<< ", \"depth\": " << record.depth << ", \"seconds\": " << record.seconds
+		<< ", \"nodes\": " << c.nodes() << ", \"chance_nodes\": " << c.chanceNodes()
+		<< ", \"evaluations\": " << c.evaluations() << ", \"cache_lookups\": " << c.cacheLookups()
+		<< ", \"cache_hits\": " << c.cacheHits() << ", \"pruned_branches\": " << c.prunedBranches()
+		<< ", \"branching_factor\": " << record.branchingFactor()
+		<< ", \"cache_entries\": " << record.cacheEntries
+		<< ", \"peak_memory\": " << record.peakMemory
+		<< ", \"book_hit\": " << (record.bookHit ? "true" : "false")
+		<< ", \"max_nodes\": [";
+
+	// Only list the plies that the search has actually reached.
+	unsigned int plies = SearchCounters::MAX_PLIES;
+	while(plies > 1 && c.maxNodes(plies - 1) == 0) plies--;
+	for(unsigned int ply = 0; ply < plies; ply++) {
+		os << (ply ? ", " : "") << c.maxNodes(ply);
+	}
+	os << "]}\n";
+}
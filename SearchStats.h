@@ -0,0 +1,127 @@
+#ifndef SEARCH_STATS_H
+#define SEARCH_STATS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+/**
+ * Counters describing what a search did. Every thread counts into its own
+ * ThreadSearchCounters, so counting only costs a plain increment;
+ * aggregate_search_counters() sums up the counters of all threads on
+ * demand.
+ *
+ * Counting can be removed at compile time by defining
+ * GAME2048_NO_SEARCH_STATS, in which case GAME2048_COUNT expands to nothing.
+**/
+
+#ifdef GAME2048_NO_SEARCH_STATS
+  #define GAME2048_COUNT(counters, index, n) ((void) 0)
+#else
+  #define GAME2048_COUNT(counters, index, n) (counters)->add((index), (n))
+#endif
+
+//! Indices of the individual counters.
+enum SearchCounter: unsigned int {
+	//! The number of max nodes at ply i is counted at index MAX_NODES + i.
+	MAX_NODES = 0,
+	CHANCE_NODES = 16,
+	//! The number of boards passed to the evaluator.
+	EVALUATIONS,
+	CACHE_LOOKUPS,
+	CACHE_HITS,
+	//! Chance nodes not expanded due to their low probability.
+	PRUNED_BRANCHES,
+	NUM_SEARCH_COUNTERS
+};
+
+//! A snapshot of the search counters.
+struct SearchCounters {
+	static constexpr unsigned int MAX_PLIES = CHANCE_NODES - MAX_NODES;
+
+	uint64_t values[NUM_SEARCH_COUNTERS];
+
+	uint64_t maxNodes(unsigned int ply) const {return values[MAX_NODES + ply];}
+	uint64_t chanceNodes() const {return values[CHANCE_NODES];}
+	uint64_t evaluations() const {return values[EVALUATIONS];}
+	uint64_t cacheLookups() const {return values[CACHE_LOOKUPS];}
+	uint64_t cacheHits() const {return values[CACHE_HITS];}
+	uint64_t prunedBranches() const {return values[PRUNED_BRANCHES];}
+
+	//! The number of max and chance nodes.
+	uint64_t nodes() const;
+
+	SearchCounters& operator+=(const SearchCounters& obj);
+	SearchCounters& operator-=(const SearchCounters& obj);
+
+	SearchCounters();
+};
+
+inline SearchCounters operator-(SearchCounters a, const SearchCounters& b) {return a -= b;}
+inline SearchCounters operator+(SearchCounters a, const SearchCounters& b) {return a += b;}
+
+//! The counters of a single thread. Only the owning thread may call add(),
+//! but any thread can take a snapshot.
+class ThreadSearchCounters {
+private:
+	std::atomic<uint64_t> _values[NUM_SEARCH_COUNTERS];
+
+public:
+	inline void add(unsigned int index, uint64_t n) {
+		// A single writer: no need for an atomic read-modify-write.
+		_values[index].store(_values[index].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+
+	SearchCounters snapshot() const;
+
+public:
+	ThreadSearchCounters& operator=(const ThreadSearchCounters&) = delete;
+	ThreadSearchCounters(const ThreadSearchCounters&) = delete;
+
+	ThreadSearchCounters();
+	~ThreadSearchCounters();
+};
+
+//! Returns the counters of the calling thread.
+ThreadSearchCounters& thread_search_counters();
+
+//! Returns the sum of the counters of all threads, including the ones that
+//! have already exited.
+SearchCounters aggregate_search_counters();
+
+//! Describes a single call to a player's selectAction().
+struct SearchRecord {
+	//! The search depth.
+	unsigned int depth;
+	//! What the search did; all zeros if compiled without search stats.
+	SearchCounters counters;
+	//! The wall-clock time of the search.
+	double seconds;
+	//! The number of entries in the transposition table after the search.
+	std::size_t cacheEntries;
+	//! The peak resident memory of the process so far, in bytes.
+	std::size_t peakMemory;
+	//! True if the move was taken from an opening book without searching.
+	bool bookHit;
+
+	//! The effective branching factor per unit of depth (a move together
+	//! with the following tile spawn, i.e. a max and a chance layer): the b
+	//! such that b^depth equals the number of nodes searched plus the number
+	//! of leaves evaluated. Leaves are counted because at the horizon they
+	//! are most of the work.
+	double branchingFactor() const;
+
+	SearchRecord(): depth(0), counters(), seconds(0), cacheEntries(0), peakMemory(0), bookHit(false) {}
+};
+
+//! Writes the header line of the CSV produced by write_csv().
+void write_csv_header(std::ostream& os);
+//! Writes one line of CSV describing the search that selected the
+//! specified action at the specified move of a game.
+void write_csv(std::ostream& os, unsigned int move, unsigned int action, const SearchRecord& record);
+//! Writes the same information as a JSON object followed by a newline
+//! (so that a sequence of records forms a JSON Lines file).
+void write_json(std::ostream& os, unsigned int move, unsigned int action, const SearchRecord& record);
+
+#endif // SEARCH_STATS_H
@@ -0,0 +1,31 @@
+#ifndef SELF_PLAY_H
+#define SELF_PLAY_H
+
+#include "GameBoard.h"
+#include "ExpectimaxPlayer.h"
+
+//! Returns the record of the search done by the last call to selectAction,
+//! or nullptr if the player does not search.
+template<class Player>
+const SearchRecord* last_stats(const Player&) {return nullptr;}
+
+template<class Evaluator>
+const SearchRecord* last_stats(const ExpectimaxPlayer<Evaluator>& player) {return &player.lastStats();}
+
+/**
+ * Lets the player play from the board until the game is over and returns
+ * the final board. After every move onMove(move, action, board) is called,
+ * where board is the state resulting from the action.
+**/
+template<class Player, class Callback>
+GameBoard play_game(Player& player, GameBoard board, Callback onMove) {
+	for(unsigned int move = 0; !board.isGameOver(); move++) {
+		auto action = player.selectAction(board);
+		board = board.next(action);
+		onMove(move, action, board);
+	}
+
+	return board;
+}
+
+#endif // SELF_PLAY_H
@@ -0,0 +1,91 @@
+#ifndef TRANSPOSITION_TABLE_H
+#define TRANSPOSITION_TABLE_H
+
+#include "GameBoard.h"
+#include <atomic>
+#include <memory>
+#include <cstring>
+#include <cstddef>
+
+/**
+ * A fixed-size transposition table that can be shared by searches running
+ * in several threads at once.
+ *
+ * The table is direct-mapped and lockless: every slot holds the data word
+ * (the search depth and the value) and the board xor'ed with the data
+ * word. A reader accepts a slot only if xor-ing the two words yields the
+ * board it is looking for, so a slot torn by a concurrent write is simply
+ * treated as a miss. Colliding entries are replaced.
+**/
+class TranspositionTable {
+public:
+	typedef GameBoard::board_t board_t;
+
+private:
+	struct Slot {
+		std::atomic<uint64_t> check;
+		std::atomic<uint64_t> data;
+	};
+
+private:
+	std::unique_ptr<Slot[]> _slots;
+	unsigned int _sizeLog2;
+
+private:
+	inline Slot& slot(board_t board) const {
+		// Fibonacci hashing: the high bits of the product are well mixed.
+		return _slots[(board * 0x9E3779B97F4A7C15ULL) >> (64 - _sizeLog2)];
+	}
+
+public:
+	//! Looks up the value of the board. Only succeeds if the stored value
+	//! has been computed to at least the specified depth.
+	bool lookup(board_t board, unsigned int depth, float& value) const {
+		const Slot& s = slot(board);
+		uint64_t data = s.data.load(std::memory_order_relaxed);
+		uint64_t check = s.check.load(std::memory_order_relaxed);
+		if((check ^ data) != board || (data >> 32) < depth) return false;
+
+		uint32_t bits = uint32_t(data);
+		std::memcpy(&value, &bits, sizeof(value));
+		return true;
+	}
+
+	void store(board_t board, unsigned int depth, float value) {
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		uint64_t data = (uint64_t(depth) << 32) | bits;
+
+		Slot& s = slot(board);
+		s.data.store(data, std::memory_order_relaxed);
+		s.check.store(board ^ data, std::memory_order_relaxed);
+	}
+
+	//! Removes all entries. Must not be called while the table is in use.
+	void clear() {
+		for(std::size_t i = 0; i < size(); i++) {
+			_slots[i].check.store(0, std::memory_order_relaxed);
+			_slots[i].data.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	//! Returns the number of slots.
+	std::size_t size() const {return std::size_t(1) << _sizeLog2;}
+	//! Returns the memory used by the slots in bytes.
+	std::size_t memory() const {return size() * sizeof(Slot);}
+
+public:
+	TranspositionTable& operator=(const TranspositionTable&) = delete;
+	TranspositionTable(const TranspositionTable&) = delete;
+
+	//! Creates a table with 2^sizeLog2 slots of 16 bytes each.
+	explicit TranspositionTable(unsigned int sizeLog2 = 22):
+		_slots(), _sizeLog2(sizeLog2)
+	{
+		if(sizeLog2 < 1 || sizeLog2 > 40) throw std::runtime_error("The table size must be between 2^1 and 2^40 slots.");
+		_slots.reset(new Slot[size()]);
+		clear();
+	}
+};
+
+#endif // TRANSPOSITION_TABLE_H
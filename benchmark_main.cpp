@@ -0,0 +1,494 @@
+#include "GameBoard.h"
+#include "LegalPlayer.h"
+#include "ExpectimaxPlayer.h"
+#include "SelfPlay.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * A reproducible benchmark of playing strength versus compute.
+ *
+ * Plays a fixed set of games -- game i spawns its tiles from a random
+ * engine seeded with seed + i (see seed_default_generator), so the results
+ * do not depend on the number of threads -- and reports the distribution of scores, the rates of
+ * reaching the big tiles and the CPU time used. The results can be saved
+ * as a baseline and later runs compared against it using significance
+ * tests. Both runs play the same games, so the tests are paired: the
+ * Wilcoxon signed-rank test for scores and CPU time per move, and
+ * McNemar's test for the tile reach rates.
+**/
+
+namespace {
+
+struct GameResult {
+	unsigned int seed;
+	float score;
+	unsigned int maxTile;
+	unsigned int moves;
+	double cpuSeconds;
+};
+
+struct Config {
+	std::string player;
+	unsigned int depth;
+	unsigned int games;
+	unsigned int seed;
+	unsigned int threads;
+	std::string bookPath;
+	std::string savePath;
+	std::string baselinePath;
+	double alpha;
+	bool failOnRegression;
+	//! Not an option: the random engine and seeding the games are played with.
+	std::string rng;
+
+	Config(): player("expectimax"), depth(2), games(100), seed(1), threads(0),
+		bookPath(), savePath(), baselinePath(), alpha(0.05), failOnRegression(false),
+		rng(default_generator_description()) {}
+};
+
+const unsigned int REACH_TILES[] = {2048, 4096, 8192, 16384};
+
+/*******************************************************************************
+ * Playing
+*******************************************************************************/
+
+template<class MakePlayer>
+std::vector<GameResult> run_games(const Config& config, MakePlayer makePlayer) {
+	std::vector<GameResult> results(config.games);
+	std::atomic<unsigned int> nextGame(0);
+
+	auto worker = [&]() {
+		auto player = makePlayer();
+
+		for(unsigned int i = nextGame++; i < config.games; i = nextGame++) {
+			GameResult& result = results[i];
+			result.seed = config.seed + i;
+			seed_default_generator(result.seed);
+
+			double start = thread_cpu_time();
+			unsigned int moves = 0;
+			GameBoard board = play_game(player, GameBoard(),
+				[&](unsigned int, GameBoard::GameAction, const GameBoard&) {moves++;});
+
+			result.cpuSeconds = thread_cpu_time() - start;
+			result.score = board.getScore();
+			result.maxTile = 1u << board.maxRank();
+			result.moves = moves;
+		}
+	};
+
+	unsigned int threads = config.threads;
+	if(threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+	std::vector<std::thread> pool;
+	for(unsigned int t = 0; t < threads; t++) pool.emplace_back(worker);
+	for(auto& thread: pool) thread.join();
+
+	return results;
+}
+
+std::vector<GameResult> run_games(const Config& config) {
+	if(config.player == "legal") {
+		return run_games(config, []() {return LegalPlayer();});
+	} else if(config.player == "expectimax") {
+		std::shared_ptr<const OpeningBook> book;
+		if(!config.bookPath.empty()) book = std::make_shared<OpeningBook>(config.bookPath);
+
+		return run_games(config, [&]() {
+			ExpectimaxPlayer<> player(config.depth);
+			player.setOpeningBook(book);
+			return player;
+		});
+	}
+
+	throw std::runtime_error("Unknown player '" + config.player + "'.");
+}
+
+/*******************************************************************************
+ * Statistics
+*******************************************************************************/
+
+double mean(const std::vector<double>& values) {
+	double sum = 0;
+	for(double value: values) sum += value;
+	return values.empty() ? 0 : sum / values.size();
+}
+
+double stddev(const std::vector<double>& values) {
+	if(values.size() < 2) return 0;
+	double m = mean(values), sum = 0;
+	for(double value: values) sum += (value - m) * (value - m);
+	return std::sqrt(sum / (values.size() - 1));
+}
+
+//! Returns the q-quantile of the values, interpolating linearly.
+double quantile(std::vector<double> values, double q) {
+	if(values.empty()) return 0;
+	std::sort(values.begin(), values.end());
+	double pos = q * (values.size() - 1);
+	std::size_t i = std::size_t(pos);
+	if(i + 1 >= values.size()) return values.back();
+	return values[i] + (pos - i) * (values[i+1] - values[i]);
+}
+
+//! The two-sided p-value of a standard normal z-score.
+double normal_p_value(double z) {
+	return std::erfc(std::fabs(z) / std::sqrt(2.0));
+}
+
+/**
+ * The Wilcoxon signed-rank test of the paired values (normal approximation
+ * with tie correction and continuity correction; pairs with no difference
+ * are dropped). Returns the two-sided p-value; z is positive if the values
+ * in b tend to be greater than those in a.
+**/
+double wilcoxon_signed_rank(const std::vector<double>& a, const std::vector<double>& b, double& z) {
+	z = 0;
+
+	std::vector<double> diffs;
+	for(std::size_t i = 0; i < a.size() && i < b.size(); i++) {
+		if(a[i] < b[i] || b[i] < a[i]) diffs.push_back(b[i] - a[i]);
+	}
+
+	std::size_t n = diffs.size();
+	if(n == 0) return 1;
+
+	std::sort(diffs.begin(), diffs.end(), [](double x, double y) {return std::fabs(x) < std::fabs(y);});
+
+	// Rank the absolute differences, averaging the ranks of ties.
+	double rankSumPositive = 0, tieTerm = 0;
+	for(std::size_t i = 0; i < n;) {
+		std::size_t j = i;
+		// Sorted, so not greater means equal.
+		while(j < n && !(std::fabs(diffs[i]) < std::fabs(diffs[j]))) j++;
+
+		double rank = (i + 1 + j) / 2.0;
+		for(std::size_t k = i; k < j; k++) if(diffs[k] > 0) rankSumPositive += rank;
+
+		double t = j - i;
+		tieTerm += t * t * t - t;
+		i = j;
+	}
+
+	double mu = n * (n + 1) / 4.0;
+	double sigma = std::sqrt(n * (n + 1) * (2 * n + 1) / 24.0 - tieTerm / 48.0);
+	if(sigma <= 0) return 1;
+
+	double diff = rankSumPositive - mu;
+	diff = (diff > 0) ? std::max(0.0, diff - 0.5) : std::min(0.0, diff + 0.5);
+	z = diff / sigma;
+	return normal_p_value(z);
+}
+
+//! McNemar's test of paired outcomes (normal approximation with continuity
+//! correction), given the number of pairs where only the first and where
+//! only the second outcome is positive. Returns the two-sided p-value; z
+//! is positive if the second outcome is positive more often.
+double mcnemar(std::size_t onlyFirst, std::size_t onlySecond, double& z) {
+	z = 0;
+	if(onlyFirst + onlySecond == 0) return 1;
+
+	double diff = double(onlySecond) - double(onlyFirst);
+	diff = (diff > 0) ? std::max(0.0, diff - 1) : std::min(0.0, diff + 1);
+	z = diff / std::sqrt(double(onlyFirst + onlySecond));
+	return normal_p_value(z);
+}
+
+std::vector<double> scores(const std::vector<GameResult>& results) {
+	std::vector<double> values;
+	for(auto& result: results) values.push_back(result.score);
+	return values;
+}
+
+std::vector<double> cpu_per_move(const std::vector<GameResult>& results) {
+	std::vector<double> values;
+	for(auto& result: results) values.push_back(result.cpuSeconds / std::max(1u, result.moves));
+	return values;
+}
+
+std::size_t reach_count(const std::vector<GameResult>& results, unsigned int tile) {
+	return std::count_if(results.begin(), results.end(),
+		[tile](const GameResult& result) {return result.maxTile >= tile;});
+}
+
+/*******************************************************************************
+ * Reporting
+*******************************************************************************/
+
+void report(const std::vector<GameResult>& results, double wallSeconds) {
+	auto s = scores(results);
+	double cpu = 0;
+	unsigned long moves = 0;
+	for(auto& result: results) {
+		cpu += result.cpuSeconds;
+		moves += result.moves;
+	}
+
+	std::cout << std::fixed << std::setprecision(1)
+		<< "games:          " << results.size() << "\n"
+		<< "score mean:     " << mean(s) << " (stddev " << stddev(s) << ")\n"
+		<< "score quantiles: min " << quantile(s, 0) << ", 10% " << quantile(s, 0.1)
+		<< ", median " << quantile(s, 0.5) << ", 90% " << quantile(s, 0.9)
+		<< ", max " << quantile(s, 1) << "\n";
+
+	for(unsigned int tile: REACH_TILES) {
+		std::cout << "reached " << std::setw(5) << tile << ":  "
+			<< 100.0 * reach_count(results, tile) / std::max<std::size_t>(1, results.size()) << "%\n";
+	}
+
+	std::cout << std::setprecision(3)
+		<< "total moves:    " << moves << "\n"
+		<< "total CPU time: " << cpu << " s\n"
+		<< "CPU per move:   " << 1e6 * cpu / std::max(1ul, moves) << " us\n"
+		<< "wall time:      " << wallSeconds << " s\n";
+}
+
+//! Compares the results to the baseline game by game; returns true if the
+//! results are significantly worse in playing strength. The results must
+//! be of the same games (see check_baseline).
+bool compare(const std::vector<GameResult>& baseline, const std::vector<GameResult>& results, double alpha) {
+	bool regression = false;
+	double z, p;
+
+	// The direction of a change is taken from the sign of the test statistic
+	// z (positive if the current values tend to be greater), not from the
+	// displayed values: a paired shift need not move the median.
+	auto row = [&](const std::string& name, double before, double after, double pValue, double zValue, bool higherIsBetter) {
+		bool significant = pValue < alpha;
+		bool worse = significant && (higherIsBetter ? zValue < 0 : zValue > 0);
+		std::cout << std::left << std::setw(18) << name << std::right << std::setprecision(3)
+			<< std::setw(14) << before << std::setw(14) << after
+			<< std::setw(12) << pValue
+			<< (significant ? (worse ? "  worse" : "  better") : "") << "\n";
+		return worse;
+	};
+
+	std::cout << "\ncomparison against the baseline (significance level " << alpha << "):\n"
+		<< std::left << std::setw(18) << "metric" << std::right << std::setw(14) << "baseline"
+		<< std::setw(14) << "current" << std::setw(12) << "p-value" << "\n";
+
+	auto s0 = scores(baseline), s1 = scores(results);
+	p = wilcoxon_signed_rank(s0, s1, z);
+	regression |= row("median score", quantile(s0, 0.5), quantile(s1, 0.5), p, z, true);
+
+	for(unsigned int tile: REACH_TILES) {
+		std::size_t k0 = reach_count(baseline, tile), k1 = reach_count(results, tile);
+		std::size_t onlyBaseline = 0, onlyResults = 0;
+		for(std::size_t i = 0; i < baseline.size() && i < results.size(); i++) {
+			bool r0 = baseline[i].maxTile >= tile, r1 = results[i].maxTile >= tile;
+			if(r0 && !r1) onlyBaseline++;
+			if(r1 && !r0) onlyResults++;
+		}
+
+		p = mcnemar(onlyBaseline, onlyResults, z);
+		regression |= row("reached " + std::to_string(tile) + " %",
+			100.0 * k0 / std::max<std::size_t>(1, baseline.size()),
+			100.0 * k1 / std::max<std::size_t>(1, results.size()), p, z, true);
+	}
+
+	// Only reported: CPU time depends on the machine and its load.
+	auto c0 = cpu_per_move(baseline), c1 = cpu_per_move(results);
+	p = wilcoxon_signed_rank(c0, c1, z);
+	row("CPU us/move", 1e6 * quantile(c0, 0.5), 1e6 * quantile(c1, 0.5), p, z, false);
+
+	return regression;
+}
+
+/*******************************************************************************
+ * Baseline files
+*******************************************************************************/
+
+void save_results(const std::string& path, const Config& config, const std::vector<GameResult>& results) {
+	std::ofstream file(path);
+	// The book comes last, as its path may contain spaces.
+	file << "# Game2048Benchmark results\n"
+		<< "# player " << config.player << " depth " << config.depth
+		<< " games " << config.games << " seed " << config.seed
+		<< (config.bookPath.empty() ? "" : " book " + config.bookPath) << "\n"
+		<< "# rng " << config.rng << "\n"
+		<< "seed score max_tile moves cpu_seconds\n";
+
+	file << std::setprecision(9);
+	for(auto& result: results) {
+		file << result.seed << " " << result.score << " " << result.maxTile << " "
+			<< result.moves << " " << result.cpuSeconds << "\n";
+	}
+
+	if(!file) throw std::runtime_error("Cannot write the results into '" + path + "'.");
+}
+
+//! Loads the results saved by save_results; the configuration they were
+//! produced with is stored into config.
+std::vector<GameResult> load_results(const std::string& path, Config& config) {
+	std::ifstream file(path);
+	if(!file) throw std::runtime_error("Cannot open the baseline '" + path + "'.");
+
+	std::vector<GameResult> results;
+	bool hasConfig = false;
+	std::string line;
+	config.rng.clear();
+
+	while(std::getline(file, line)) {
+		if(line.compare(0, 6, "# rng ") == 0) {
+			config.rng = line.substr(6);
+			continue;
+		}
+
+		if(line.compare(0, 9, "# player ") == 0) {
+			std::istringstream stream(line.substr(2));
+			std::string key;
+			bool ok = true;
+
+			while(ok && stream >> key) {
+				if(key == "player") ok = bool(stream >> config.player);
+				else if(key == "depth") ok = bool(stream >> config.depth);
+				else if(key == "games") ok = bool(stream >> config.games);
+				else if(key == "seed") ok = bool(stream >> config.seed);
+				else if(key == "book") ok = bool(std::getline(stream >> std::ws, config.bookPath));
+				else ok = false;
+			}
+
+			if(!ok) throw std::runtime_error("Malformed configuration in the baseline '" + path + "': " + line);
+			hasConfig = true;
+			continue;
+		}
+
+		if(line.empty() || line[0] == '#' || line.compare(0, 4, "seed") == 0) continue;
+
+		std::istringstream stream(line);
+		GameResult result;
+		if(!(stream >> result.seed >> result.score >> result.maxTile >> result.moves >> result.cpuSeconds)) {
+			throw std::runtime_error("Malformed line in the baseline '" + path + "': " + line);
+		}
+		results.push_back(result);
+	}
+
+	if(!hasConfig) throw std::runtime_error("The baseline '" + path + "' has no configuration line.");
+	return results;
+}
+
+/**
+ * Checks that the baseline can be compared to a run with the given
+ * configuration. The comparison is game by game, so both must play the
+ * same games: a different number of games, seed or random engine is an
+ * error. A different
+ * player, depth or book is what one may want to compare, so it only gets
+ * a warning.
+**/
+void check_baseline(const Config& baseline, const Config& config, std::size_t numResults) {
+	if(baseline.rng != config.rng) {
+		throw std::runtime_error("The baseline was played with the random engine '" +
+			(baseline.rng.empty() ? std::string("unknown") : baseline.rng) + "', this build uses '" +
+			config.rng + "'; save a new baseline.");
+	}
+
+	if(baseline.games != config.games || baseline.seed != config.seed) {
+		throw std::runtime_error("The baseline was played with --games " + std::to_string(baseline.games) +
+			" --seed " + std::to_string(baseline.seed) + "; use the same values to compare against it.");
+	}
+
+	if(numResults != baseline.games) {
+		throw std::runtime_error("The baseline holds " + std::to_string(numResults) +
+			" games instead of " + std::to_string(baseline.games) + ".");
+	}
+
+	auto describe = [](const Config& c) {
+		return "--player " + c.player + " --depth " + std::to_string(c.depth) +
+			(c.bookPath.empty() ? "" : " --book " + c.bookPath);
+	};
+
+	if(baseline.player != config.player || baseline.depth != config.depth || baseline.bookPath != config.bookPath) {
+		std::cerr << "warning: the baseline was played with " << describe(baseline)
+			<< ", this run uses " << describe(config) << "\n";
+	}
+}
+
+void print_usage(const char* name) {
+	std::cerr << "Usage: " << name << " [options]\n"
+		<< "Options:\n"
+		<< "  --player legal|expectimax  the player to benchmark (default: expectimax)\n"
+		<< "  --depth N                  search depth of the expectimax player (default: 2)\n"
+		<< "  --book FILE                opening book consulted by the expectimax player\n"
+		<< "  --games N                  number of games (default: 100)\n"
+		<< "  --seed N                   seed of the first game (default: 1)\n"
+		<< "  --threads N                number of threads (default: one per core)\n"
+		<< "  --save FILE                save the results as a baseline\n"
+		<< "  --baseline FILE            compare the results against a saved baseline\n"
+		<< "  --alpha P                  significance level of the comparison (default: 0.05)\n"
+		<< "  --fail-on-regression       exit with status 2 if the playing strength is\n"
+		<< "                             significantly worse than the baseline\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	Config config;
+
+	try {
+		for(int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			bool hasValue = i + 1 < argc;
+
+			if(arg == "--player" && hasValue) config.player = argv[++i];
+			else if(arg == "--depth" && hasValue) config.depth = std::stoul(argv[++i]);
+			else if(arg == "--book" && hasValue) config.bookPath = argv[++i];
+			else if(arg == "--games" && hasValue) config.games = std::stoul(argv[++i]);
+			else if(arg == "--seed" && hasValue) config.seed = std::stoul(argv[++i]);
+			else if(arg == "--threads" && hasValue) config.threads = std::stoul(argv[++i]);
+			else if(arg == "--save" && hasValue) config.savePath = argv[++i];
+			else if(arg == "--baseline" && hasValue) config.baselinePath = argv[++i];
+			else if(arg == "--alpha" && hasValue) config.alpha = std::stod(argv[++i]);
+			else if(arg == "--fail-on-regression") config.failOnRegression = true;
+			else {
+				print_usage(argv[0]);
+				return 1;
+			}
+		}
+	} catch(std::exception&) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	// Checked up front, as the players are only constructed in the threads.
+	if(config.depth == 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	try {
+		// Load the baseline first so that a bad path or a mismatch fails early.
+		std::vector<GameResult> baseline;
+		if(!config.baselinePath.empty()) {
+			Config baselineConfig;
+			baseline = load_results(config.baselinePath, baselineConfig);
+			check_baseline(baselineConfig, config, baseline.size());
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		auto results = run_games(config);
+		double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		report(results, wallSeconds);
+		if(!config.savePath.empty()) save_results(config.savePath, config, results);
+
+		if(!config.baselinePath.empty()) {
+			bool regression = compare(baseline, results, config.alpha);
+			if(regression && config.failOnRegression) return 2;
+		}
+	} catch(std::exception& e) {
+		std::cerr << e.what() << "\n";
+		return 1;
+	}
+
+	return 0;
+}
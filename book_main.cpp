@@ -0,0 +1,176 @@
+#include "OpeningBook.h"
+#include "ExpectimaxPlayer.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * Builds an opening book: enumerates all positions reachable from the
+ * initial boards within a given number of moves (and optionally up to
+ * a given sum of tiles), searches each of them deeply in parallel and
+ * writes the results into a book file.
+**/
+
+namespace {
+
+typedef GameBoard::board_t board_t;
+
+unsigned int tile_sum(board_t board) {
+	unsigned int sum = 0;
+	for(; board; board >>= 4) {
+		if(board & 0xf) sum += 1u << (board & 0xf);
+	}
+	return sum;
+}
+
+//! Returns the canonical forms of all positions (before the player's move)
+//! reachable within maxMoves moves whose tile sum does not exceed maxSum
+//! (0 means no limit).
+std::vector<board_t> enumerate_positions(unsigned int maxMoves, unsigned int maxSum) {
+	std::unordered_set<board_t> seen;
+	std::vector<board_t> frontier, positions;
+
+	auto visit = [&](board_t board, std::vector<board_t>& next) {
+		if(maxSum && tile_sum(board) > maxSum) return;
+		board = BoardMethods::canonical_board(board);
+		if(seen.insert(board).second) next.push_back(board);
+	};
+
+	// The initial boards hold two tiles in distinct cells.
+	for(unsigned int i = 0; i < 16; i++) {
+		for(unsigned int j = i + 1; j < 16; j++) {
+			for(board_t ti = 1; ti <= 2; ti++) {
+				for(board_t tj = 1; tj <= 2; tj++) {
+					visit((ti << (4*i)) | (tj << (4*j)), frontier);
+				}
+			}
+		}
+	}
+
+	for(unsigned int move = 0;; move++) {
+		positions.insert(positions.end(), frontier.begin(), frontier.end());
+		if(move == maxMoves || frontier.empty()) break;
+
+		std::vector<board_t> next;
+		for(board_t board: frontier) {
+			auto after = BoardMethods::execute_all(board);
+			for(unsigned int a = 0; a < 4; a++) {
+				if(!(after.legal & (1 << a))) continue;
+
+				board_t afterstate = after.boards[a];
+				for(board_t cells = BoardMethods::empty_mask(afterstate); cells; cells &= cells - 1) {
+					board_t tile = cells & (~cells + 1);
+					visit(afterstate | tile, next);
+					visit(afterstate | (tile << 1), next);
+				}
+			}
+		}
+
+		frontier.swap(next);
+	}
+
+	return positions;
+}
+
+void print_usage(const char* name) {
+	std::cerr << "Usage: " << name << " [options] <book file>\n"
+		<< "Options:\n"
+		<< "  --max-moves N    include positions up to N moves into the game (default: 2)\n"
+		<< "  --max-sum N      only include positions whose tiles sum up to at most N\n"
+		<< "  --depth N        search depth (default: 5)\n"
+		<< "  --threads N      number of threads (default: one per core)\n"
+		<< "  --table-bits N   shared transposition table has 2^N slots (default: 24)\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	std::string path;
+	unsigned int maxMoves = 2, maxSum = 0, depth = 5, threads = 0, tableBits = 24;
+
+	try {
+		for(int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			bool hasValue = i + 1 < argc;
+
+			if(arg == "--max-moves" && hasValue) maxMoves = std::stoul(argv[++i]);
+			else if(arg == "--max-sum" && hasValue) maxSum = std::stoul(argv[++i]);
+			else if(arg == "--depth" && hasValue) depth = std::stoul(argv[++i]);
+			else if(arg == "--threads" && hasValue) threads = std::stoul(argv[++i]);
+			else if(arg == "--table-bits" && hasValue) tableBits = std::stoul(argv[++i]);
+			else if(arg.compare(0, 2, "--") != 0 && path.empty()) path = arg;
+			else {
+				print_usage(argv[0]);
+				return 1;
+			}
+		}
+	} catch(std::exception&) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if(path.empty()) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	// Checked up front, as the players are only constructed in the threads.
+	if(depth == 0) {
+		std::cerr << "The search depth must be at least 1.\n";
+		return 1;
+	}
+
+	if(threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+	try {
+		auto positions = enumerate_positions(maxMoves, maxSum);
+		std::cerr << positions.size() << " positions to search\n";
+
+		auto table = std::make_shared<TranspositionTable>(tableBits);
+		std::vector<OpeningBook::Entry> entries(positions.size());
+		std::atomic<std::size_t> nextIndex(0);
+
+		auto worker = [&]() {
+			ExpectimaxPlayer<> player(depth);
+			player.setSharedTable(table);
+
+			for(std::size_t i = nextIndex++; i < positions.size(); i = nextIndex++) {
+				OpeningBook::Entry& entry = entries[i];
+				std::memset(&entry, 0, sizeof(entry));
+				entry.board = positions[i];
+
+				// Positions are canonical, so are the actions.
+				try {
+					entry.action = player.selectAction(GameBoard(positions[i]));
+					entry.value = player.lastValue();
+				} catch(IllegalAction&) {
+					entry.action = GameBoard::None;
+				}
+
+				if((i + 1) % 1000 == 0) std::cerr << (i + 1) << " / " << positions.size() << "\n";
+			}
+		};
+
+		std::vector<std::thread> pool;
+		for(unsigned int t = 0; t < threads; t++) pool.emplace_back(worker);
+		for(auto& thread: pool) thread.join();
+
+		// Game-over positions have no move to store.
+		entries.erase(std::remove_if(entries.begin(), entries.end(),
+			[](const OpeningBook::Entry& entry) {return entry.action == GameBoard::None;}),
+			entries.end());
+
+		OpeningBook::write(path, entries, depth);
+		std::cerr << "wrote " << entries.size() << " positions into " << path << "\n";
+	} catch(std::exception& e) {
+		std::cerr << e.what() << "\n";
+		return 1;
+	}
+
+	return 0;
+}
@@ -1,21 +1,91 @@
 #include "GameBoard.h"
 #include <iostream>
+#include <fstream>
+#include <memory>
 #include <string>
 
 #include "LegalPlayer.h"
+#include "ExpectimaxPlayer.h"
+#include "SelfPlay.h"
 
-int main() {
-	LegalPlayer player;
+namespace {
 
+template<class Player>
+void play(Player& player, std::ostream* csv, std::ostream* json) {
 	GameBoard board;
 	std::cout << "score: " << board.getScore() << "\n\n";
 	std::cout << board << std::endl;
 
-	while(!board.isGameOver()) {
-		auto move = player.selectAction(board);      
-		board = board.next(move);
-        auto score = board.getScore();
-		std::cout << "score: " << score << "\n\n";		
-	}
+	if(csv) write_csv_header(*csv);
+
+	play_game(player, board, [&](unsigned int move, GameBoard::GameAction action, const GameBoard& next) {
+		auto stats = last_stats(player);
+		if(stats && csv) write_csv(*csv, move, action, *stats);
+		if(stats && json) write_json(*json, move, action, *stats);
+
+		std::cout << "score: " << next.getScore() << "\n\n";
+	});
+}
+
+void print_usage(const char* name) {
+	std::cerr << "Usage: " << name << " [options]\n"
+		<< "Options:\n"
+		<< "  --player legal|expectimax  the player to use (default: legal)\n"
+		<< "  --depth N                  search depth of the expectimax player (default: 3)\n"
+		<< "  --book FILE                opening book consulted by the expectimax player\n"
+		<< "  --stats-csv FILE           write a CSV record of every search into FILE\n"
+		<< "  --stats-json FILE          write a JSON Lines record of every search into FILE\n";
 }
 
+} // namespace
+
+int main(int argc, char** argv) {
+	std::string playerName = "legal";
+	unsigned int depth = 3;
+	std::string bookPath;
+	std::unique_ptr<std::ofstream> csv, json;
+
+	try {
+		for(int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			bool hasValue = i + 1 < argc;
+
+			if(arg == "--player" && hasValue) playerName = argv[++i];
+			else if(arg == "--depth" && hasValue) depth = std::stoul(argv[++i]);
+			else if(arg == "--book" && hasValue) bookPath = argv[++i];
+			else if(arg == "--stats-csv" && hasValue) csv.reset(new std::ofstream(argv[++i]));
+			else if(arg == "--stats-json" && hasValue) json.reset(new std::ofstream(argv[++i]));
+			else {
+				print_usage(argv[0]);
+				return 1;
+			}
+		}
+	} catch(std::exception&) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if((csv && !*csv) || (json && !*json)) {
+		std::cerr << "Cannot open the stats file.\n";
+		return 1;
+	}
+
+	try {
+		if(playerName == "legal") {
+			LegalPlayer player;
+			play(player, csv.get(), json.get());
+		} else if(playerName == "expectimax") {
+			ExpectimaxPlayer<> player(depth);
+			if(!bookPath.empty()) player.setOpeningBook(std::make_shared<OpeningBook>(bookPath));
+			play(player, csv.get(), json.get());
+		} else {
+			print_usage(argv[0]);
+			return 1;
+		}
+	} catch(std::exception& e) {
+		std::cerr << e.what() << "\n";
+		return 1;
+	}
+
+	return 0;
+}
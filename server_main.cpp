@@ -0,0 +1,79 @@
+#include "MoveServer.h"
+#include <iostream>
+#include <string>
+#include <csignal>
+#include <pthread.h>
+
+namespace {
+
+void print_usage(const char* name) {
+	std::cerr << "Usage: " << name << " [options] <socket path>\n"
+		<< "Options:\n"
+		<< "  --threads N      number of worker threads (default: one per core)\n"
+		<< "  --depth N        search depth (default: 3)\n"
+		<< "  --prob P         probability threshold of the search (default: 0.0001)\n"
+		<< "  --table-bits N   transposition table has 2^N slots (default: 24)\n"
+		<< "  --batch N        boards a worker takes off the queue at once (default: 64)\n"
+		<< "  --max-pending N  requests of a connection awaiting their responses\n"
+		<< "                   before it is no longer read from (default: 16)\n"
+		<< "  --book FILE      opening book to consult before searching\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	MoveServer::Options options;
+
+	try {
+		for(int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			bool hasValue = i + 1 < argc;
+
+			if(arg == "--threads" && hasValue) options.threads = std::stoul(argv[++i]);
+			else if(arg == "--depth" && hasValue) options.depth = std::stoul(argv[++i]);
+			else if(arg == "--prob" && hasValue) options.probThreshold = std::stof(argv[++i]);
+			else if(arg == "--table-bits" && hasValue) options.tableSizeLog2 = std::stoul(argv[++i]);
+			else if(arg == "--batch" && hasValue) options.batchSize = std::stoul(argv[++i]);
+			else if(arg == "--max-pending" && hasValue) options.maxPending = std::stoul(argv[++i]);
+			else if(arg == "--book" && hasValue) options.bookPath = argv[++i];
+			else if(arg.compare(0, 2, "--") != 0 && options.socketPath.empty()) options.socketPath = arg;
+			else {
+				print_usage(argv[0]);
+				return 1;
+			}
+		}
+	} catch(std::exception&) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if(options.socketPath.empty()) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	// Block the termination signals in all threads; the main thread waits
+	// for them synchronously below.
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+	try {
+		MoveServer server(options);
+		server.start();
+		std::cerr << "listening on " << options.socketPath << "\n";
+
+		int signal;
+		sigwait(&signals, &signal);
+
+		std::cerr << "shutting down\n";
+		server.stop();
+	} catch(std::exception& e) {
+		std::cerr << e.what() << "\n";
+		return 1;
+	}
+
+	return 0;
+}
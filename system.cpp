@@ -1,2 +1,29 @@
 #include "system.h"
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+std::size_t peak_memory_usage() {
+#if defined(__unix__) || defined(__APPLE__)
+	rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+	#if defined(__APPLE__)
+		return usage.ru_maxrss;
+	#else
+		// Linux reports the value in kilobytes.
+		return std::size_t(usage.ru_maxrss) * 1024;
+	#endif
+#else
+	return 0;
+#endif
+}
+
+double thread_cpu_time() {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+	timespec ts;
+	if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+	return double(std::clock()) / CLOCKS_PER_SEC;
+}
@@ -2,26 +2,73 @@
 #define SYSTEM_H
 
 #include <random>
+#include <cstddef>
 #include <cstdlib>
 #include <ctime>
 #include <stdexcept>
+#include <type_traits>
 
-//! Returns the default random engine.
+//! Returns the default random engine. Every thread has its own engine
+//! (except on old MinGW, which lacks proper thread_local support).
 inline std::default_random_engine& default_generator() {
 	#if defined(__MINGW32_MAJOR_VERSION) && __MINGW32_MAJOR_VERSION < 5
 		static std::default_random_engine generator(time(NULL));
 	#else
-		static std::default_random_engine generator(std::random_device{}());
+		thread_local std::default_random_engine generator(std::random_device{}());
 	#endif
 	return generator;
 }
 
+//! Reseeds the default random engine of the calling thread, making
+//! everything that draws from it (such as tile spawns) reproducible.
+//! The seed is mixed through std::seed_seq first: the first output of a
+//! linear congruential engine is linear in a raw seed, so nearby seeds
+//! would all start with nearly the same number.
+inline void seed_default_generator(unsigned int seed) {
+	std::seed_seq sequence{seed};
+	default_generator().seed(sequence);
+}
+
+//! Describes the default random engine, the way seed_default_generator
+//! seeds it and the standard library providing the engine and the
+//! distributions. Sequences drawn from equal seeds only match if this does.
+inline const char* default_generator_description() {
+	typedef std::default_random_engine engine;
+
+	#if defined(_LIBCPP_VERSION)
+		#define GAME2048_STDLIB "libc++"
+	#elif defined(__GLIBCXX__)
+		#define GAME2048_STDLIB "libstdc++"
+	#elif defined(_MSC_VER)
+		#define GAME2048_STDLIB "msvc"
+	#else
+		#define GAME2048_STDLIB "unknown"
+	#endif
+
+	const char* description =
+		std::is_same<engine, std::minstd_rand0>::value ? "minstd_rand0+seed_seq/" GAME2048_STDLIB :
+		std::is_same<engine, std::minstd_rand>::value ? "minstd_rand+seed_seq/" GAME2048_STDLIB :
+		std::is_same<engine, std::mt19937>::value ? "mt19937+seed_seq/" GAME2048_STDLIB :
+		"unknown+seed_seq/" GAME2048_STDLIB;
+
+	#undef GAME2048_STDLIB
+	return description;
+}
+
 //! Returns a random number in [0..n-1].
 inline unsigned int unif_random(unsigned int n) {
 	std::uniform_int_distribution<unsigned int> distro(0, n-1);
 	return distro(default_generator());
 }
 
+//! Returns the peak resident memory of the process in bytes, or 0 if it
+//! is not available on this platform.
+std::size_t peak_memory_usage();
+
+//! Returns the CPU time consumed by the calling thread in seconds. Falls
+//! back to the CPU time of the whole process where that is not available.
+double thread_cpu_time();
+
 //! MSVC compatibility: undefine max and min macros.
 #if defined(max)
 #undef max